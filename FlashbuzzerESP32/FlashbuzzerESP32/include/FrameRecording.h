@@ -0,0 +1,360 @@
+#pragma once
+
+// Compact recording of the LED frame stream plus input events, used to reproduce what a mode
+// did at a venue. Like QuizSync.h this has no Arduino dependencies, so the firmware encodes
+// with it and tools/replay.cpp decodes with it on a PC.
+//
+// Layout, all integers little-endian, "varint" is unsigned LEB128:
+//   header    'F' 'B' 'R' '1', u16 number of LEDs, u16 keyframe interval
+//   keyframe  0x01, u32 absolute time in ms, raw RGB bytes of every LED
+//   delta     0x02, varint ms since the previous record, then runs until every byte of the
+//             frame is covered: varint unchanged bytes, varint (n << 1 | packed), then n
+//             bytes XORed with the previous frame. Fading LEDs mostly change by small amounts,
+//             so a run can instead be packed into nibbles, low nibble first: 0..14 is the value
+//             itself, 15 is followed by the low and the high nibble of a larger value.
+//   event     0x03, varint ms since the previous record, u8 event type, u8 value
+// A keyframe is written every keyframe interval frames and whenever a delta would be larger,
+// so a truncated recording still decodes up to the point where it was cut.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#define RECORDING_HEADER_SIZE 8
+#define RECORDING_KEYFRAME_INTERVAL 256
+#define RECORDING_MIN_SKIP 4       // Shorter gaps of unchanged bytes stay inside a literal run
+#define RECORDING_NIBBLE_ESCAPE 15  // In packed runs, this nibble is followed by a full byte as two nibbles
+
+enum RecordType {
+    RECORD_KEYFRAME = 1,
+    RECORD_DELTA,
+    RECORD_EVENT
+};
+
+enum RecordEvent {
+    EVENT_BUTTON_DOWN = 1,
+    EVENT_BUTTON_UP
+};
+
+// Writes records into a fixed buffer owned by the caller. On the ESP32 that is one large
+// PSRAM buffer, or without PSRAM a series of small blocks that are written to flash.
+class FrameEncoder {
+public:
+    FrameEncoder() : buffer(nullptr), capacity(0), used(0), numLeds(0), keyframeInterval(0),
+        framesSinceKeyframe(0), frameCount(0), eventCount(0), lastTime(0), full(false) {}
+
+    bool begin(uint8_t* target, size_t targetCapacity, uint16_t leds,
+               uint16_t keyInterval = RECORDING_KEYFRAME_INTERVAL) {
+        buffer = target;
+        capacity = targetCapacity;
+        used = 0;
+        numLeds = leds;
+        keyframeInterval = keyInterval;
+        framesSinceKeyframe = keyInterval; // Forces a keyframe first
+        frameCount = 0;
+        eventCount = 0;
+        lastTime = 0;
+        full = false;
+        previous.assign((size_t)leds * 3, 0);
+        changes.resize((size_t)leds * 3);
+
+        if (capacity < RECORDING_HEADER_SIZE) {
+            full = true;
+            return false;
+        }
+        const uint8_t header[RECORDING_HEADER_SIZE] = {
+            'F', 'B', 'R', '1',
+            (uint8_t)(leds & 0xFF), (uint8_t)(leds >> 8),
+            (uint8_t)(keyInterval & 0xFF), (uint8_t)(keyInterval >> 8)
+        };
+        memcpy(buffer, header, RECORDING_HEADER_SIZE);
+        used = RECORDING_HEADER_SIZE;
+        return true;
+    }
+
+    // Carries on with the same recording in a new buffer, after the caller has stored data().
+    // The delta reference is kept, so the new buffer only holds the records that follow.
+    void continueIn(uint8_t* target, size_t targetCapacity) {
+        buffer = target;
+        capacity = targetCapacity;
+        used = 0;
+        full = false;
+    }
+
+    // rgb holds 3 bytes per LED. Returns false once the buffer is full, the record is then
+    // dropped completely so the recording stays decodable and can be retried after continueIn().
+    bool addFrame(const uint8_t* rgb, uint32_t timeMs) {
+        if (full) return false;
+        size_t frameBytes = previous.size();
+        size_t start = used;
+
+        bool written = false;
+        if (framesSinceKeyframe < keyframeInterval) {
+            for (size_t i = 0; i < frameBytes; i++) {
+                changes[i] = rgb[i] ^ previous[i];
+            }
+            written = writeDelta(timeMs);
+            // A delta that is not smaller than a keyframe isn't worth the dependency on the previous frame
+            if (written && used - start >= frameBytes + 5) {
+                used = start;
+                written = false;
+            }
+        }
+        if (!written) {
+            used = start;
+            if (!writeKeyframe(rgb, timeMs)) {
+                used = start;
+                full = true;
+                return false;
+            }
+            framesSinceKeyframe = 0;
+        }
+
+        memcpy(previous.data(), rgb, frameBytes);
+        framesSinceKeyframe++;
+        frameCount++;
+        lastTime = timeMs;
+        return true;
+    }
+
+    bool addEvent(uint8_t type, uint8_t value, uint32_t timeMs) {
+        if (full) return false;
+        size_t start = used;
+        if (!put(RECORD_EVENT) || !putVarint(timeMs - lastTime) || !put(type) || !put(value)) {
+            used = start;
+            full = true;
+            return false;
+        }
+        eventCount++;
+        lastTime = timeMs;
+        return true;
+    }
+
+    const uint8_t* data() const { return buffer; }
+    size_t size() const { return used; }
+    bool isFull() const { return full; }
+    uint32_t frames() const { return frameCount; }
+    uint32_t events() const { return eventCount; }
+
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t used;
+    uint16_t numLeds;
+    uint16_t keyframeInterval;
+    uint16_t framesSinceKeyframe;
+    uint32_t frameCount;
+    uint32_t eventCount;
+    uint32_t lastTime;
+    bool full;
+    std::vector<uint8_t> previous; // Last frame written, the reference for the next delta
+    std::vector<uint8_t> changes;  // XOR of the current and the previous frame
+
+    bool put(uint8_t value) {
+        if (used >= capacity) return false;
+        buffer[used++] = value;
+        return true;
+    }
+
+    bool putVarint(uint32_t value) {
+        while (value >= 0x80) {
+            if (!put((uint8_t)(value | 0x80))) return false;
+            value >>= 7;
+        }
+        return put((uint8_t)value);
+    }
+
+    bool writeKeyframe(const uint8_t* rgb, uint32_t timeMs) {
+        if (!put(RECORD_KEYFRAME)) return false;
+        for (int i = 0; i < 4; i++) {
+            if (!put((uint8_t)(timeMs >> (8 * i)))) return false;
+        }
+        if (capacity - used < previous.size()) return false;
+        memcpy(buffer + used, rgb, previous.size());
+        used += previous.size();
+        return true;
+    }
+
+    bool writeDelta(uint32_t timeMs) {
+        if (!put(RECORD_DELTA) || !putVarint(timeMs - lastTime)) return false;
+        size_t n = changes.size();
+        size_t pos = 0;
+        while (pos < n) {
+            size_t skip = 0;
+            while (pos + skip < n && changes[pos + skip] == 0) skip++;
+            pos += skip;
+
+            // Literal runs swallow short gaps of unchanged bytes, starting a new run costs more than that
+            size_t literal = 0;
+            while (pos + literal < n && !startsSkip(pos + literal)) {
+                literal++;
+            }
+            if (!writeRun(pos, literal, skip)) return false;
+            pos += literal;
+        }
+        return true;
+    }
+
+    bool startsSkip(size_t pos) {
+        for (size_t i = pos; i < pos + RECORDING_MIN_SKIP; i++) {
+            if (i >= changes.size()) return true;
+            if (changes[i] != 0) return false;
+        }
+        return true;
+    }
+
+    // Nibble packing pays off when most values are small, otherwise the run is stored plain
+    bool writeRun(size_t start, size_t count, size_t skip) {
+        size_t nibbles = count;
+        for (size_t i = 0; i < count; i++) {
+            if (changes[start + i] >= RECORDING_NIBBLE_ESCAPE) nibbles += 2;
+        }
+        bool packed = (nibbles + 1) / 2 < count;
+        if (!putVarint(skip) || !putVarint((count << 1) | (packed ? 1 : 0))) return false;
+
+        if (!packed) {
+            if (capacity - used < count) return false;
+            memcpy(buffer + used, changes.data() + start, count);
+            used += count;
+            return true;
+        }
+        if (capacity - used < (nibbles + 1) / 2) return false;
+        size_t nibble = 0;
+        memset(buffer + used, 0, (nibbles + 1) / 2);
+        for (size_t i = 0; i < count; i++) {
+            uint8_t value = changes[start + i];
+            if (value < RECORDING_NIBBLE_ESCAPE) {
+                putNibble(nibble++, value);
+            } else {
+                putNibble(nibble++, RECORDING_NIBBLE_ESCAPE);
+                putNibble(nibble++, value & 0x0F);
+                putNibble(nibble++, value >> 4);
+            }
+        }
+        used += (nibbles + 1) / 2;
+        return true;
+    }
+
+    void putNibble(size_t index, uint8_t value) {
+        buffer[used + index / 2] |= (index & 1) ? value << 4 : value;
+    }
+};
+
+// Walks through a recording record by record
+class FrameDecoder {
+public:
+    enum Result { FRAME, EVENT, END, CORRUPT };
+
+    FrameDecoder() : data(nullptr), length(0), position(0), numLeds(0), keyframeInterval(0),
+        currentTime(0), eventType(0), eventValue(0), haveFrame(false) {}
+
+    bool begin(const uint8_t* recording, size_t recordingLength) {
+        data = recording;
+        length = recordingLength;
+        position = RECORDING_HEADER_SIZE;
+        currentTime = 0;
+        haveFrame = false;
+        if (length < RECORDING_HEADER_SIZE || memcmp(data, "FBR1", 4) != 0) return false;
+        numLeds = data[4] | (data[5] << 8);
+        keyframeInterval = data[6] | (data[7] << 8);
+        frame.assign((size_t)numLeds * 3, 0);
+        return true;
+    }
+
+    // Decode the next record. After FRAME, frameData() holds the new frame; after EVENT,
+    // eventType and eventValue are set. time() is valid after both.
+    Result next() {
+        if (position >= length) return END;
+        uint8_t type = data[position++];
+        uint32_t delta;
+
+        if (type == RECORD_KEYFRAME) {
+            if (length - position < 4 + frame.size()) return CORRUPT;
+            currentTime = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16)
+                | ((uint32_t)data[position + 3] << 24);
+            position += 4;
+            memcpy(frame.data(), data + position, frame.size());
+            position += frame.size();
+            haveFrame = true;
+            return FRAME;
+        }
+        if (type == RECORD_DELTA) {
+            if (!haveFrame || !getVarint(delta)) return CORRUPT;
+            size_t pos = 0;
+            while (pos < frame.size()) {
+                uint32_t skip, run;
+                if (!getVarint(skip) || !getVarint(run)) return CORRUPT;
+                uint32_t literal = run >> 1;
+                bool packed = run & 1;
+                if (skip + literal == 0 || (size_t)skip + literal > frame.size() - pos) return CORRUPT;
+                pos += skip;
+                if (!packed) {
+                    if (literal > length - position) return CORRUPT;
+                    for (uint32_t i = 0; i < literal; i++) {
+                        frame[pos++] ^= data[position++];
+                    }
+                    continue;
+                }
+                size_t nibble = 0;
+                for (uint32_t i = 0; i < literal; i++) {
+                    uint8_t value, low, high;
+                    if (!getNibble(nibble++, value)) return CORRUPT;
+                    if (value == RECORDING_NIBBLE_ESCAPE) {
+                        if (!getNibble(nibble++, low) || !getNibble(nibble++, high)) return CORRUPT;
+                        value = low | (high << 4);
+                    }
+                    frame[pos++] ^= value;
+                }
+                position += (nibble + 1) / 2;
+            }
+            currentTime += delta;
+            return FRAME;
+        }
+        if (type == RECORD_EVENT) {
+            if (!getVarint(delta) || length - position < 2) return CORRUPT;
+            eventType = data[position++];
+            eventValue = data[position++];
+            currentTime += delta;
+            return EVENT;
+        }
+        return CORRUPT;
+    }
+
+    const uint8_t* frameData() const { return frame.data(); }
+    uint16_t leds() const { return numLeds; }
+    uint32_t time() const { return currentTime; }
+    uint8_t lastEventType() const { return eventType; }
+    uint8_t lastEventValue() const { return eventValue; }
+
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+    uint16_t numLeds;
+    uint16_t keyframeInterval;
+    uint32_t currentTime;
+    uint8_t eventType;
+    uint8_t eventValue;
+    bool haveFrame;
+    std::vector<uint8_t> frame;
+
+    // Nibble 'index' of the packed run starting at position
+    bool getNibble(size_t index, uint8_t& value) {
+        if (position + index / 2 >= length) return false;
+        uint8_t b = data[position + index / 2];
+        value = (index & 1) ? b >> 4 : b & 0x0F;
+        return true;
+    }
+
+    bool getVarint(uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (position >= length) return false;
+            uint8_t b = data[position++];
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,321 @@
+#pragma once
+
+// Clock sync and first-press arbitration for the multi-buzzer quiz mode.
+// Nothing in here touches Arduino or WiFi, so the same logic runs on the ESP32
+// and on a Linux host (see tools/quizsim.cpp). All times are microseconds.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define QUIZ_PORT 4210                   // UDP port used by host and clients
+#define QUIZ_MAX_DEVICES 16              // Device ids 0..15, the host is always id 0
+#define QUIZ_HOST_ID 0
+#define QUIZ_NO_WINNER 0xFF
+#define QUIZ_MESSAGE_SIZE 32             // Size of an encoded QuizMessage in bytes
+#define QUIZ_SYNC_SAMPLES 8              // Sync samples kept for the min-delay filter
+#define QUIZ_SYNC_INTERVAL_US 200000     // How often clients ping the host
+#define QUIZ_ARBITRATION_WINDOW_US 30000 // How long the host waits for late packets after the first press
+#define QUIZ_PRESS_REPEATS 3             // Press packets are sent this often to survive packet loss
+
+enum QuizMessageType {
+    QUIZ_SYNC_REQUEST = 1, // client -> host: t0 = client send time
+    QUIZ_SYNC_REPLY,       // host -> client: t0 echoed, t1 = host receive time, t2 = host send time
+    QUIZ_PRESS,            // client -> host: t0 = press time on the host clock, t1 = sync uncertainty
+    QUIZ_RESULT            // host -> clients: winnerId and t0 = winning press time
+};
+
+struct QuizMessage {
+    uint8_t type = 0;
+    uint8_t deviceId = 0;
+    uint8_t winnerId = QUIZ_NO_WINNER; // Current winner of the round, QUIZ_NO_WINNER while armed
+    uint16_t round = 0;                // Incremented by the host every time it re-arms
+    int64_t t0 = 0;
+    int64_t t1 = 0;
+    int64_t t2 = 0;
+
+    // Serialize into a fixed little-endian layout so ESP32 and host agree on the wire format
+    size_t encode(uint8_t* buffer) const {
+        buffer[0] = 'Q';
+        buffer[1] = type;
+        buffer[2] = deviceId;
+        buffer[3] = winnerId;
+        buffer[4] = round & 0xFF;
+        buffer[5] = round >> 8;
+        buffer[6] = 0;
+        buffer[7] = 0;
+        putInt64(buffer + 8, t0);
+        putInt64(buffer + 16, t1);
+        putInt64(buffer + 24, t2);
+        return QUIZ_MESSAGE_SIZE;
+    }
+
+    // Returns false for anything that is not a quiz packet
+    bool decode(const uint8_t* buffer, size_t length) {
+        if (length != QUIZ_MESSAGE_SIZE || buffer[0] != 'Q') return false;
+        if (buffer[1] < QUIZ_SYNC_REQUEST || buffer[1] > QUIZ_RESULT) return false;
+        if (buffer[2] >= QUIZ_MAX_DEVICES) return false;
+        type = buffer[1];
+        deviceId = buffer[2];
+        winnerId = buffer[3];
+        round = buffer[4] | (buffer[5] << 8);
+        t0 = getInt64(buffer + 8);
+        t1 = getInt64(buffer + 16);
+        t2 = getInt64(buffer + 24);
+        return true;
+    }
+
+private:
+    static void putInt64(uint8_t* p, int64_t value) {
+        uint64_t v = (uint64_t)value;
+        for (int i = 0; i < 8; i++) {
+            p[i] = (uint8_t)(v >> (8 * i));
+        }
+    }
+
+    static int64_t getInt64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) {
+            v |= (uint64_t)p[i] << (8 * i);
+        }
+        return (int64_t)v;
+    }
+};
+
+// NTP-style offset estimation. Every exchange gives an offset and a round trip delay;
+// the sample with the smallest delay out of the last few is the one least disturbed by
+// WiFi retries and loop() latency, so that one is used.
+class ClockSync {
+public:
+    ClockSync() { reset(); }
+
+    void reset() {
+        sampleCount = 0;
+        nextSample = 0;
+        bestOffset = 0;
+        bestDelay = -1;
+    }
+
+    // t0 = local send, t1 = host receive, t2 = host send, t3 = local receive
+    void addSample(int64_t t0, int64_t t1, int64_t t2, int64_t t3) {
+        int64_t delay = (t3 - t0) - (t2 - t1);
+        if (delay < 0) return; // Host took longer than the whole round trip, clocks are broken
+        offsets[nextSample] = ((t1 - t0) + (t2 - t3)) / 2;
+        delays[nextSample] = delay;
+        nextSample = (nextSample + 1) % QUIZ_SYNC_SAMPLES;
+        if (sampleCount < QUIZ_SYNC_SAMPLES) sampleCount++;
+
+        // Pick the sample with the shortest round trip
+        bestDelay = -1;
+        for (int i = 0; i < sampleCount; i++) {
+            if (bestDelay < 0 || delays[i] < bestDelay) {
+                bestDelay = delays[i];
+                bestOffset = offsets[i];
+            }
+        }
+    }
+
+    bool isSynced() const { return sampleCount > 0; }
+
+    // Host clock minus local clock
+    int64_t offset() const { return bestOffset; }
+
+    // Worst case error of offset(): the true offset lies within +/- half the round trip
+    int64_t uncertainty() const { return bestDelay < 0 ? -1 : bestDelay / 2; }
+
+    int64_t toHostTime(int64_t localTime) const { return localTime + bestOffset; }
+
+private:
+    int64_t offsets[QUIZ_SYNC_SAMPLES];
+    int64_t delays[QUIZ_SYNC_SAMPLES];
+    int sampleCount;
+    int nextSample;
+    int64_t bestOffset;
+    int64_t bestDelay;
+};
+
+// Decides which device pressed first. Presses arrive in network order, not press order,
+// so after the first one arrives the arbiter keeps collecting for a short window and
+// then picks the earliest timestamp. Everyone else stays locked out until rearm().
+class QuizArbiter {
+public:
+    enum State { ARMED, COLLECTING, LOCKED };
+
+    QuizArbiter(int64_t windowUs = QUIZ_ARBITRATION_WINDOW_US)
+        : window(windowUs), currentState(ARMED), currentRound(0), armedAt(0), firstArrival(0),
+          winnerId(QUIZ_NO_WINNER), winnerTime(0) {}
+
+    // Start a new round. Presses stamped before 'now' belong to the old round and are dropped.
+    void rearm(int64_t now) {
+        currentState = ARMED;
+        currentRound++;
+        armedAt = now;
+        winnerId = QUIZ_NO_WINNER;
+        winnerTime = 0;
+    }
+
+    // Returns false if the press was ignored (wrong round, too early or already locked)
+    bool submitPress(uint8_t deviceId, uint16_t round, int64_t pressTime, int64_t now) {
+        if (currentState == LOCKED || round != currentRound || pressTime < armedAt) return false;
+        if (deviceId >= QUIZ_MAX_DEVICES) return false;
+
+        if (currentState == ARMED) {
+            currentState = COLLECTING;
+            firstArrival = now;
+        }
+        // Earliest timestamp wins, exact ties go to the lower id so the result is deterministic
+        if (winnerId == QUIZ_NO_WINNER || pressTime < winnerTime ||
+            (pressTime == winnerTime && deviceId < winnerId)) {
+            winnerId = deviceId;
+            winnerTime = pressTime;
+        }
+        return true;
+    }
+
+    // Returns true exactly once, when the collection window closes and the winner is final
+    bool update(int64_t now) {
+        if (currentState == COLLECTING && now - firstArrival >= window) {
+            currentState = LOCKED;
+            return true;
+        }
+        return false;
+    }
+
+    State state() const { return currentState; }
+    uint16_t round() const { return currentRound; }
+    int64_t lockedSince() const { return firstArrival + window; }
+
+    // Only meaningful once state() is LOCKED
+    uint8_t winner() const { return currentState == LOCKED ? winnerId : QUIZ_NO_WINNER; }
+    int64_t winningPressTime() const { return winnerTime; }
+
+private:
+    int64_t window;
+    State currentState;
+    uint16_t currentRound;
+    int64_t armedAt;
+    int64_t firstArrival;
+    uint8_t winnerId;
+    int64_t winnerTime;
+};
+
+// Protocol state of the host unit. The caller owns the socket: it feeds in received
+// messages and sends whatever this class asks it to send.
+class QuizHost {
+public:
+    QuizHost(int64_t lockTimeUs, int64_t windowUs = QUIZ_ARBITRATION_WINDOW_US)
+        : arbiter(windowUs), lockTime(lockTimeUs) {}
+
+    void begin(int64_t now) { arbiter.rearm(now); }
+
+    void setLockTime(int64_t lockTimeUs) { lockTime = lockTimeUs; }
+
+    // Handle a received packet. Returns true if 'reply' should be sent back to the sender;
+    // the caller stamps reply.t2 right before sending it.
+    bool handle(const QuizMessage& in, int64_t rxTime, QuizMessage& reply) {
+        if (in.type == QUIZ_SYNC_REQUEST) {
+            reply = QuizMessage();
+            reply.type = QUIZ_SYNC_REPLY;
+            reply.deviceId = in.deviceId;
+            reply.round = arbiter.round();
+            reply.winnerId = arbiter.winner();
+            reply.t0 = in.t0;
+            reply.t1 = rxTime;
+            return true;
+        }
+        if (in.type == QUIZ_PRESS) {
+            arbiter.submitPress(in.deviceId, in.round, in.t0, rxTime);
+        }
+        return false;
+    }
+
+    // The host's own button, already on the host clock
+    void localPress(int64_t pressTime, int64_t now) {
+        arbiter.submitPress(QUIZ_HOST_ID, arbiter.round(), pressTime, now);
+    }
+
+    // Returns true when 'announce' should be sent to every client: once when a winner
+    // is decided and once when the lock expires and a new round starts.
+    bool update(int64_t now, QuizMessage& announce) {
+        bool changed = arbiter.update(now);
+        if (!changed && arbiter.state() == QuizArbiter::LOCKED && now - arbiter.lockedSince() >= lockTime) {
+            arbiter.rearm(now);
+            changed = true;
+        }
+        if (changed) {
+            announce = QuizMessage();
+            announce.type = QUIZ_RESULT;
+            announce.deviceId = QUIZ_HOST_ID;
+            announce.round = arbiter.round();
+            announce.winnerId = arbiter.winner();
+            announce.t0 = arbiter.winningPressTime();
+        }
+        return changed;
+    }
+
+    uint8_t winner() const { return arbiter.winner(); }
+    uint16_t round() const { return arbiter.round(); }
+    int64_t winningPressTime() const { return arbiter.winningPressTime(); }
+
+private:
+    QuizArbiter arbiter;
+    int64_t lockTime;
+};
+
+// Protocol state of a client unit: keeps its clock synced to the host and tracks the
+// round state the host announces.
+class QuizClient {
+public:
+    QuizClient(uint8_t id) : deviceId(id), lastSyncRequest(0), syncRequested(false),
+        currentRound(0), winnerId(QUIZ_NO_WINNER) {}
+
+    uint8_t id() const { return deviceId; }
+
+    // Returns true when a sync request should be sent now
+    bool wantsSync(int64_t now, QuizMessage& request) {
+        if (syncRequested && now - lastSyncRequest < QUIZ_SYNC_INTERVAL_US) return false;
+        syncRequested = true;
+        lastSyncRequest = now;
+        request = QuizMessage();
+        request.type = QUIZ_SYNC_REQUEST;
+        request.deviceId = deviceId;
+        request.t0 = now;
+        return true;
+    }
+
+    void handle(const QuizMessage& in, int64_t rxTime) {
+        if (in.type == QUIZ_SYNC_REPLY && in.deviceId == deviceId) {
+            clock.addSample(in.t0, in.t1, in.t2, rxTime);
+        }
+        if (in.type == QUIZ_SYNC_REPLY || in.type == QUIZ_RESULT) {
+            currentRound = in.round;
+            winnerId = in.winnerId;
+        }
+    }
+
+    // Build the press message for an ISR timestamp. Returns false while not synced yet
+    // or while the round is locked, there is nothing to win then.
+    bool makePress(int64_t localPressTime, QuizMessage& press) const {
+        if (!clock.isSynced() || winnerId != QUIZ_NO_WINNER) return false;
+        press = QuizMessage();
+        press.type = QUIZ_PRESS;
+        press.deviceId = deviceId;
+        press.round = currentRound;
+        press.t0 = clock.toHostTime(localPressTime);
+        press.t1 = clock.uncertainty();
+        return true;
+    }
+
+    bool isSynced() const { return clock.isSynced(); }
+    bool isWinner() const { return winnerId == deviceId; }
+    bool isLockedOut() const { return winnerId != QUIZ_NO_WINNER && winnerId != deviceId; }
+    uint8_t winner() const { return winnerId; }
+    const ClockSync& clockSync() const { return clock; }
+
+private:
+    uint8_t deviceId;
+    ClockSync clock;
+    int64_t lastSyncRequest;
+    bool syncRequested;
+    uint16_t currentRound;
+    uint8_t winnerId;
+};
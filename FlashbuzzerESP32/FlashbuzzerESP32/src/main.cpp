@@ -5,9 +5,18 @@
 #include <Arduino.h>
 #include <Preferences.h>  // For non-volatile memory storage (NVS)
 #include <FastLED.h>
+#include <AsyncUDP.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <esp_wifi.h>
+#include <driver/gpio.h>
+#include <LittleFS.h>
+#include <functional>
 
 #include <vector>
 #include <FastLED.h>
+#include "QuizSync.h"
+#include "FrameRecording.h"
 
 #define NUM_LEDS 300      // Define the number of LEDs in your strip
 #define LED_PIN 16        // Define your LED strip pin
@@ -15,29 +24,133 @@
 #define DEFAULT_COLOR CRGB::Red // Default color for the running dots
 #define BUTTON_PIN 13  // Pin where the button is connected
 #define DEFAULT_WIDTH 1
+#define DEFAULT_GAMMA 2.2f
+#define OUTPUT_LUT_SIZE 257     // 256 segments over the 16-bit input range, interpolated in between
+#define OUTPUT_MAX 65280        // 255.0 in the 8.8 fixed point output of the LUT
 
-class RunningDot {
+// 16 bits per channel, the working format of the frame buffer before it goes to the strip
+struct CRGB16 {
+    uint16_t r, g, b;
+};
+
+// Sits between the frame buffer and FastLED: applies brightness, gamma and white balance in
+// one precomputed LUT and dithers the 16-bit result down to 8 bits over time, so dim tails
+// fade smoothly instead of stepping. The LUT is only rebuilt when one of its inputs changes.
+class OutputStage {
 public:
-    // Constructor: Initialize variables with default color and brightness
-    RunningDot() : lastUpdateTime(0), speed(30.0f), currentColor(DEFAULT_COLOR), currentBrightness(DEFAULT_BRIGHTNESS), dotWidth(DEFAULT_WIDTH) {}
+    OutputStage() : brightness(DEFAULT_BRIGHTNESS), gamma(DEFAULT_GAMMA), lutDirty(true) {
+        whiteBalance[0] = whiteBalance[1] = whiteBalance[2] = 1.0f;
+        memset(ditherError, 0, sizeof(ditherError));
+    }
 
-    // Initialize FastLED in setup
+    // Initialize FastLED, brightness and dithering are handled here instead
     void begin()
     {
         FastLED.addLeds<WS2812B, LED_PIN, GRB>(leds, NUM_LEDS);
-        FastLED.setBrightness(currentBrightness);
+        FastLED.setBrightness(255);
+        FastLED.setDither(DISABLE_DITHER);
         FastLED.clear();
         FastLED.show();
     }
 
+    void setBrightness(uint8_t newBrightness)
+    {
+        if (newBrightness == brightness) return;
+        brightness = newBrightness;
+        lutDirty = true;
+    }
+
+    void setGamma(float newGamma)
+    {
+        if (newGamma <= 0.0f || newGamma == gamma) return;
+        gamma = newGamma;
+        lutDirty = true;
+    }
+
+    // Per channel scale factors 0..1, to make full white look white on a given strip
+    void setWhiteBalance(float red, float green, float blue)
+    {
+        if (red == whiteBalance[0] && green == whiteBalance[1] && blue == whiteBalance[2]) return;
+        whiteBalance[0] = red;
+        whiteBalance[1] = green;
+        whiteBalance[2] = blue;
+        lutDirty = true;
+    }
+
+    // Convert a frame and send it to the strip
+    void show(const CRGB16* frame)
+    {
+        if (lutDirty) buildLut();
+        for (int i = 0; i < NUM_LEDS; i++) {
+            leds[i].r = dither(lookup(0, frame[i].r), ditherError[i][0]);
+            leds[i].g = dither(lookup(1, frame[i].g), ditherError[i][1]);
+            leds[i].b = dither(lookup(2, frame[i].b), ditherError[i][2]);
+        }
+        FastLED.show();
+    }
+
+    // The 8-bit frame that was sent to the strip last
+    const CRGB* getLeds() const
+    {
+        return leds;
+    }
+
+private:
+    CRGB leds[NUM_LEDS];                       // What FastLED sends to the strip
+    uint16_t lut[3][OUTPUT_LUT_SIZE];          // Per channel: 16-bit input -> 8.8 fixed point output
+    uint8_t ditherError[NUM_LEDS][3];          // Fraction left over from the last frame, carried into the next
+    uint8_t brightness;
+    float gamma;
+    float whiteBalance[3];
+    bool lutDirty;
+
+    void buildLut()
+    {
+        for (int c = 0; c < 3; c++) {
+            float scale = OUTPUT_MAX * (brightness / 255.0f) * constrain(whiteBalance[c], 0.0f, 1.0f);
+            for (int i = 0; i < OUTPUT_LUT_SIZE; i++) {
+                lut[c][i] = (uint16_t)(powf(i / 256.0f, gamma) * scale + 0.5f);
+            }
+        }
+        lutDirty = false;
+    }
+
+    // Linear interpolation between the two LUT entries around the input
+    inline uint16_t lookup(int channel, uint16_t value) const
+    {
+        const uint16_t* entry = &lut[channel][value >> 8];
+        return entry[0] + (((int32_t)(entry[1] - entry[0]) * (value & 0xFF)) >> 8);
+    }
+
+    // Temporal dithering: the dropped fraction is added to the next frame, so over a few
+    // frames the LED averages out to the exact 8.8 value
+    static inline uint8_t dither(uint16_t value, uint8_t& error)
+    {
+        uint16_t sum = value + error;  // Can't overflow, value is at most OUTPUT_MAX
+        error = sum & 0xFF;
+        return sum >> 8;
+    }
+};
+
+class RunningDot {
+public:
+    // Constructor: Initialize variables with default color, frames are shown through the given output stage
+    RunningDot(OutputStage& outputStage) : output(outputStage), lastUpdateTime(0), speed(30.0f), currentColor(DEFAULT_COLOR), dotWidth(DEFAULT_WIDTH), fillEnabled(false), blankShown(false) {}
+
+    // Initialize the output stage in setup
+    void begin()
+    {
+        output.begin();
+    }
+
     // Trigger a new dot at the beginning of the strip with a float position
     void trigger()
     {
         activeDots.push_back(0.0f); // Add a new dot at position 0.0 (floating point)
     }
 
-    // Update the position of all dots and render them
-    void update()
+    // Update the position of all dots and render them, returns true if a new frame was shown
+    bool update()
     {
         // Get the current time
         unsigned long currentMillis = millis();
@@ -47,8 +160,18 @@ public:
 
         // If enough time has passed, update the positions of the dots
         if (deltaTime > 0.0f) {
-            // Clear the strip for new positions
-            FastLED.clear();
+            // Nothing to draw and the strip is already black, don't spend time on clear() and show()
+            bool blank = activeDots.empty() && !fillEnabled;
+            if (blank && blankShown) {
+                lastUpdateTime = currentMillis;
+                return false;
+            }
+
+            // Clear the strip for new positions, or light all of it while a fill is active
+            CRGB16 background = fillEnabled ? to16(fillColor) : CRGB16{0, 0, 0};
+            for (int i = 0; i < NUM_LEDS; i++) {
+                frame[i] = background;
+            }
 
             // Update positions of all active dots based on time passed and speed
             for (int i = 0; i < activeDots.size(); i++)
@@ -69,11 +192,14 @@ public:
                 activeDots.end());
 
             // Show the updated LED strip
-            FastLED.show();
+            output.show(frame);
+            blankShown = blank;
 
             // Update the lastUpdateTime to the current time
             lastUpdateTime = currentMillis;
+            return true;
         }
+        return false;
     }
 
     // Set the speed of the running dots (pixels per second)
@@ -88,11 +214,10 @@ public:
         currentColor = newColor;
     }
 
-    // Set the brightness of the LED strip
+    // Set the brightness of the LED strip (the output stage ignores unchanged values)
     void setBrightness(uint8_t newBrightness)
     {
-        currentBrightness = newBrightness;
-        FastLED.setBrightness(currentBrightness); // Update FastLED brightness setting
+        output.setBrightness(newBrightness);
     }
 
     // Set the width of the dot (affects brightness falloff)
@@ -101,14 +226,36 @@ public:
         dotWidth = newWidth;
     }
 
+    // Light the whole strip in one color (dots keep running on top of it) or turn that off again
+    void setFill(bool enabled, CRGB color)
+    {
+        fillEnabled = enabled;
+        fillColor = color;
+    }
+
+    // The frame that was shown last
+    const CRGB* getLeds() const
+    {
+        return output.getLeds();
+    }
+
+    // True while the strip shows a black frame that won't change until the next trigger
+    bool isIdle() const
+    {
+        return activeDots.empty() && !fillEnabled && blankShown;
+    }
+
 private:
-    CRGB leds[NUM_LEDS];           // Array to store the LED colors
+    OutputStage& output;           // Converts the frame for the strip and shows it
+    CRGB16 frame[NUM_LEDS];        // Frame buffer at 16 bits per channel
     std::vector<float> activeDots; // Vector to store the positions of active dots (float positions)
     unsigned long lastUpdateTime;  // To track when the dots were last updated
     float speed;                   // Speed of the dots in pixels per second
     CRGB currentColor;             // Current color of the running dots
-    uint8_t currentBrightness;     // Current brightness of the LED strip
     float dotWidth;                // Width of the dot (affects how quickly the brightness falls off)
+    bool fillEnabled;              // Whether the whole strip is lit (quiz winner)
+    CRGB fillColor;                // Color used while fillEnabled is set
+    bool blankShown;               // Whether the last frame sent to the strip was all black
 
     // Function to render a dot with smooth brightness fading
     void renderDot(float position)
@@ -126,14 +273,26 @@ private:
                 // Calculate brightness as a fraction (falling off linearly from the center)
                 float brightness = 1.0f - (distance / dotWidth);
 
-                // Apply the brightness to the color and add it to the existing LED state
-                leds[i] += CRGB(
-                    (uint8_t)(currentColor.r * brightness),
-                    (uint8_t)(currentColor.g * brightness),
-                    (uint8_t)(currentColor.b * brightness));
+                // Apply the brightness to the color and add it to the existing LED state, in 16 bits
+                // so the dim end of the falloff keeps its precision
+                frame[i].r = addSaturated(frame[i].r, currentColor.r * 257 * brightness);
+                frame[i].g = addSaturated(frame[i].g, currentColor.g * 257 * brightness);
+                frame[i].b = addSaturated(frame[i].b, currentColor.b * 257 * brightness);
             }
         }
     }
+
+    static uint16_t addSaturated(uint16_t value, float amount)
+    {
+        uint32_t sum = value + (uint32_t)amount;
+        return sum > 65535 ? 65535 : sum;
+    }
+
+    // Expand an 8-bit color to the 16-bit frame format (255 -> 65535)
+    static CRGB16 to16(CRGB color)
+    {
+        return CRGB16{(uint16_t)(color.r * 257), (uint16_t)(color.g * 257), (uint16_t)(color.b * 257)};
+    }
 };
 
 
@@ -262,7 +421,7 @@ private:
 class WebConfig {
 public:
     WebConfig(const char* ssid, const char* password)
-        : softAP_ssid(ssid), softAP_password(password), server(80), title("Configuration Page") {}
+        : softAP_ssid(ssid), softAP_password(password), server(80), title("Configuration Page"), lastActivity(0) {}
 
     void begin() {
         preferences.begin("webconfig", false);  // Open NVS with namespace 'webconfig'
@@ -309,11 +468,57 @@ public:
         }
     }
 
+    // Register an extra page, e.g. for status output or downloads
+    void on(const String& uri, std::function<void(WebServer&)> handler) {
+        server.on(uri.c_str(), [this, handler]() {
+            lastActivity = millis();
+            handler(server);
+        });
+    }
+
+    // No station connected and no request served for quietMs
+    bool isIdle(unsigned long quietMs) {
+        return WiFi.softAPgetStationNum() == 0 && millis() - lastActivity >= quietMs;
+    }
+
+    // Stop and restart the radio around light sleep, the access point configuration is kept
+    void suspend() {
+        esp_wifi_stop();
+    }
+
+    void resume() {
+        esp_wifi_start();
+        lastActivity = millis();
+    }
+
     // New method to set the dynamic title
     void setTitle(const String& newTitle) {
         title = newTitle;
     }
 
+    // Join another unit's access point as a station (quiz client). The own access point stays up
+    // for configuration, but moves to its own name and subnet so it doesn't collide with the host.
+    void joinNetwork(const char* ssid, const char* password, uint8_t unitId) {
+        apIP = IPAddress(8, 8, 8 + unitId, 8);
+        WiFi.mode(WIFI_AP_STA);
+        WiFi.softAPConfig(apIP, apIP, netMsk);
+        WiFi.softAP((String(softAP_ssid) + "_" + String(unitId)).c_str(), softAP_password);
+        dnsServer.stop();
+        setupDNS();
+        WiFi.setSleep(false);  // Modem sleep adds up to 100ms of latency to every packet
+        WiFi.begin(ssid, password);
+    }
+
+    // Go back to being a standalone access point
+    void leaveNetwork() {
+        WiFi.disconnect();
+        apIP = IPAddress(8, 8, 8, 8);
+        WiFi.mode(WIFI_AP);
+        dnsServer.stop();
+        configureAccessPoint();
+        setupDNS();
+    }
+
     // Uncomment this method to clear all stored parameters and reset
     /*
     void resetParameters() {
@@ -330,6 +535,7 @@ private:
     DNSServer dnsServer;
     WebServer server;
     String title;  // Dynamic title for the configuration page
+    unsigned long lastActivity;  // millis() of the last served request
 
     Preferences preferences;  // NVS Preferences for storing parameters
 
@@ -377,13 +583,15 @@ private:
                     configParams[paramName].setValue(value);
                 }
             } else if (param.second.getType() == ConfigParameter::FLOAT) {
-                float value = preferences.getFloat(paramName.c_str(), 0.0f);
+                // A parameter added since the last save keeps its registered default
+                float value = preferences.getFloat(paramName.c_str(), param.second.getFloatValue());
                 configParams[paramName].setValue(value);
             }
         }
     }
 
     void handleRoot() {
+        lastActivity = millis();
         if (captivePortal()) {
             return;
         }
@@ -615,6 +823,7 @@ private:
 
 
     void handleSubmit() {
+        lastActivity = millis();
         for (const auto& param : configParams) {
             if (server.hasArg(param.first)) {
                 if (param.second.getType() == ConfigParameter::STRING) {
@@ -631,6 +840,7 @@ private:
 
 
     void handleNotFound() {
+        lastActivity = millis();
         if (captivePortal()) {
             return;
         }
@@ -674,12 +884,569 @@ private:
     }
 };
 
+// Press timestamps are taken in the ISR so they don't depend on how long a loop() iteration takes.
+// The ISR sees both edges: a press only counts if the pin has been HIGH (released) for the
+// whole debounce time before it, so bounce on release can't register as another press.
+#define PRESS_DEBOUNCE_US 50000
+
+portMUX_TYPE pressMux = portMUX_INITIALIZER_UNLOCKED;
+volatile int64_t pressTime = 0;     // esp_timer time of the first press not yet taken by loop()
+volatile int64_t releaseTime = 0;   // esp_timer time the pin last went HIGH
+volatile bool buttonReleased = true;
+volatile bool pressPending = false;
+
+void IRAM_ATTR onButtonEdge() {
+    int64_t now = esp_timer_get_time();
+    bool high = digitalRead(BUTTON_PIN) == HIGH;
+    portENTER_CRITICAL_ISR(&pressMux);
+    if (high) {
+        if (!buttonReleased) {
+            buttonReleased = true;
+            releaseTime = now;
+        }
+    } else {
+        // Keep the first timestamp until loop() has taken it, a later press can only be later
+        if (buttonReleased && now - releaseTime >= PRESS_DEBOUNCE_US && !pressPending) {
+            pressTime = now;
+            pressPending = true;
+        }
+        buttonReleased = false;
+    }
+    portEXIT_CRITICAL_ISR(&pressMux);
+}
+
+#define QUIZ_RX_QUEUE_LENGTH 16
+#define QUIZ_MIN_LOCK_SECONDS 0.5f  // Shorter locks would end a round before anyone sees the winner
+
+// A quiz packet as it came off the network, stamped in the UDP task on arrival
+struct QuizPacket {
+    QuizMessage message;
+    int64_t rxTime;
+    uint32_t remoteIP;
+    uint16_t remotePort;
+};
+
+// Runs the quiz protocol from QuizSync.h over UDP. One unit is the host (id 0), which keeps
+// the access point and decides who pressed first; the others join its network as clients.
+// Packets are received and timestamped by AsyncUDP's own task, not by loop(): loop() can be
+// stuck in FastLED.show() for ~9ms, and that wait would otherwise end up in the sync samples.
+class QuizNode {
+public:
+    enum Role { OFF = 0, HOST = 1, CLIENT = 2 };
+
+    QuizNode() : role(OFF), unitId(0), host(0), client(0), rxQueue(nullptr) {}
+
+    void begin(Role newRole, uint8_t id, float lockSeconds) {
+        udp.close();
+        if (!rxQueue) {
+            rxQueue = xQueueCreate(QUIZ_RX_QUEUE_LENGTH, sizeof(QuizPacket));
+        }
+        xQueueReset(rxQueue);
+        int64_t ignored;
+        takePress(ignored);  // A press from before the (re)start doesn't belong to any round
+
+        role = newRole;
+        unitId = id;
+        for (int i = 0; i < QUIZ_MAX_DEVICES; i++) {
+            peerKnown[i] = false;
+        }
+        if (role == HOST) {
+            host = QuizHost(lockTimeUs(lockSeconds));
+            host.begin(esp_timer_get_time());
+        } else if (role == CLIENT) {
+            client = QuizClient(id);
+        }
+        if (role != OFF && udp.listen(QUIZ_PORT)) {
+            udp.onPacket([this](AsyncUDPPacket& packet) { onPacket(packet); });
+        }
+    }
+
+    Role getRole() const { return role; }
+    uint8_t getId() const { return unitId; }
+
+    void setLockTime(float lockSeconds) {
+        host.setLockTime(lockTimeUs(lockSeconds));
+    }
+
+    void update() {
+        int64_t localPress;
+        bool pressed = takePress(localPress);
+        if (role == OFF) return;
+        receivePackets();
+
+        int64_t now = esp_timer_get_time();
+        QuizMessage out;
+
+        if (role == HOST) {
+            if (pressed) host.localPress(localPress, now);
+            if (host.update(now, out)) {
+                for (int i = 0; i < QUIZ_MAX_DEVICES; i++) {
+                    if (peerKnown[i]) send(out, peerIP[i], peerPort[i]);
+                }
+                if (out.winnerId != QUIZ_NO_WINNER) {
+                    Serial.printf("Quiz round %u won by unit %u\n", out.round, out.winnerId);
+                }
+            }
+        } else if (WiFi.status() == WL_CONNECTED) {
+            if (client.wantsSync(now, out)) {
+                send(out, WiFi.gatewayIP(), QUIZ_PORT);
+            }
+            if (pressed && client.makePress(localPress, out)) {
+                for (int i = 0; i < QUIZ_PRESS_REPEATS; i++) {
+                    send(out, WiFi.gatewayIP(), QUIZ_PORT);
+                }
+            }
+        }
+    }
+
+    // This unit won the current round and should light its strip
+    bool isWinner() const {
+        if (role == HOST) return host.winner() == QUIZ_HOST_ID;
+        if (role == CLIENT) return client.isWinner();
+        return false;
+    }
+
+    // Another unit won the current round, presses are ignored until the host re-arms
+    bool isLockedOut() const {
+        if (role == HOST) return host.winner() != QUIZ_NO_WINNER && host.winner() != QUIZ_HOST_ID;
+        if (role == CLIENT) return client.isLockedOut();
+        return false;
+    }
+
+private:
+    Role role;
+    uint8_t unitId;
+    AsyncUDP udp;
+    QuizHost host;
+    QuizClient client;
+    QueueHandle_t rxQueue;               // QuizPackets from the UDP task to loop()
+    IPAddress peerIP[QUIZ_MAX_DEVICES];  // Where the host sends results, learned from sync requests
+    uint16_t peerPort[QUIZ_MAX_DEVICES];
+    bool peerKnown[QUIZ_MAX_DEVICES];
+
+    static int64_t lockTimeUs(float lockSeconds) {
+        return (int64_t)((lockSeconds < QUIZ_MIN_LOCK_SECONDS ? QUIZ_MIN_LOCK_SECONDS : lockSeconds) * 1000000.0f);
+    }
+
+    bool takePress(int64_t& localPress) {
+        portENTER_CRITICAL(&pressMux);
+        bool pressed = pressPending;
+        localPress = pressTime;
+        pressPending = false;
+        portEXIT_CRITICAL(&pressMux);
+        return pressed;
+    }
+
+    // Runs in the AsyncUDP task. Only stamps and queues, all protocol state stays in loop().
+    void onPacket(AsyncUDPPacket& packet) {
+        QuizPacket received;
+        received.rxTime = esp_timer_get_time();
+        if (!received.message.decode(packet.data(), packet.length())) return;
+        received.remoteIP = packet.remoteIP();
+        received.remotePort = packet.remotePort();
+        xQueueSend(rxQueue, &received, 0);  // Dropped if loop() is far behind, sync just retries
+    }
+
+    void receivePackets() {
+        QuizPacket packet;
+        while (xQueueReceive(rxQueue, &packet, 0) == pdTRUE) {
+            IPAddress remoteIP(packet.remoteIP);
+            if (role == HOST) {
+                QuizMessage reply;
+                if (packet.message.type == QUIZ_SYNC_REQUEST) {
+                    peerIP[packet.message.deviceId] = remoteIP;
+                    peerPort[packet.message.deviceId] = packet.remotePort;
+                    peerKnown[packet.message.deviceId] = true;
+                }
+                // The time spent in the queue lies between t1 and t2, so the client subtracts it out
+                if (host.handle(packet.message, packet.rxTime, reply)) {
+                    reply.t2 = esp_timer_get_time();
+                    send(reply, remoteIP, packet.remotePort);
+                }
+            } else {
+                client.handle(packet.message, packet.rxTime);
+            }
+        }
+    }
+
+    void send(const QuizMessage& msg, IPAddress ip, uint16_t port) {
+        uint8_t buffer[QUIZ_MESSAGE_SIZE];
+        size_t length = msg.encode(buffer);
+        udp.writeTo(buffer, length, ip, port);
+    }
+};
+
+// Power states of the idle governor, from most to least power hungry
+#define ACTIVE_CPU_MHZ 240
+#define IDLE_CPU_MHZ 80            // Lowest clock that still keeps WiFi running
+#define IDLE_LOW_CLOCK_AFTER_MS 2000
+#define IDLE_POLL_MS 2             // loop() pause while clocked down, bounds the press latency
+#define IDLE_WEB_QUIET_MS 60000    // No web request for this long counts as no web activity
+
+// Watches for a blank, static strip and steps the unit down: first to a lower CPU clock, then
+// into light sleep with the radio off. A press on BUTTON_PIN wakes it up again; the loop
+// renders the first frame before the radio is restarted.
+class IdleGovernor {
+public:
+    enum State { ACTIVE = 0, LOW_CLOCK, LIGHT_SLEEP, STATE_COUNT };
+
+    IdleGovernor(WebConfig& config)
+        : webConfig(config), state(ACTIVE), idleSince(0), stateSince(0), sleepAfterMs(0), radioSuspended(false) {
+        for (int i = 0; i < STATE_COUNT; i++) {
+            timeInState[i] = 0;
+        }
+    }
+
+    void begin() {
+        stateSince = esp_timer_get_time();
+        idleSince = millis();
+    }
+
+    // 0 disables light sleep, the governor then only lowers the clock
+    void setSleepAfter(float seconds) {
+        sleepAfterMs = seconds > 0 ? (unsigned long)(seconds * 1000.0f) : 0;
+    }
+
+    // Call once at the end of every loop(), after the frame has been shown
+    void update(bool stripIdle) {
+        unsigned long now = millis();
+        if (radioSuspended) {
+            // First frame after the wake-up is out, now the radio can take its time
+            webConfig.resume();
+            radioSuspended = false;
+            Serial.print("Woke up, time per power state:\n" + report());
+        }
+
+        if (!stripIdle) {
+            idleSince = now;
+            enter(ACTIVE);
+            return;
+        }
+
+        if (sleepAfterMs > 0 && now - idleSince >= sleepAfterMs && webConfig.isIdle(IDLE_WEB_QUIET_MS)
+            && digitalRead(BUTTON_PIN) == HIGH) {
+            lightSleep();
+            idleSince = millis();
+            return;
+        }
+
+        if (now - idleSince >= IDLE_LOW_CLOCK_AFTER_MS) {
+            enter(LOW_CLOCK);
+            delay(IDLE_POLL_MS);
+        }
+    }
+
+    // Time spent in every state since boot, as plain text
+    String report() {
+        accountTime();
+        int64_t total = 0;
+        for (int i = 0; i < STATE_COUNT; i++) {
+            total += timeInState[i];
+        }
+        String text;
+        for (int i = 0; i < STATE_COUNT; i++) {
+            text += String(stateName((State)i)) + ": " + String(timeInState[i] / 1000000.0, 1) + " s ("
+                + String(total > 0 ? timeInState[i] * 100.0 / total : 0.0, 1) + "%)\n";
+        }
+        return text;
+    }
+
+private:
+    WebConfig& webConfig;
+    State state;
+    unsigned long idleSince;       // millis() when the strip last became idle
+    int64_t stateSince;            // esp_timer time of the last accounting
+    int64_t timeInState[STATE_COUNT];
+    unsigned long sleepAfterMs;
+    bool radioSuspended;
+
+    static const char* stateName(State s) {
+        switch (s) {
+            case ACTIVE: return "active";
+            case LOW_CLOCK: return "low clock";
+            case LIGHT_SLEEP: return "light sleep";
+            default: return "?";
+        }
+    }
+
+    // esp_timer keeps running through light sleep, so this also covers the time asleep
+    void accountTime() {
+        int64_t now = esp_timer_get_time();
+        timeInState[state] += now - stateSince;
+        stateSince = now;
+    }
+
+    void enter(State newState) {
+        if (newState == state) return;
+        accountTime();
+        state = newState;
+        setCpuFrequencyMhz(state == ACTIVE ? ACTIVE_CPU_MHZ : IDLE_CPU_MHZ);
+    }
+
+    void lightSleep() {
+        enter(LIGHT_SLEEP);
+        Serial.println("Entering light sleep");
+        Serial.flush();
+
+        // Level wake-up replaces the pin's edge interrupt, it is restored afterwards
+        detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));
+        webConfig.suspend();
+        gpio_wakeup_enable((gpio_num_t)BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        esp_light_sleep_start();
+        gpio_wakeup_disable((gpio_num_t)BUTTON_PIN);
+        attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+
+        enter(ACTIVE);
+        radioSuspended = true;  // The report and the radio wait until the first frame is shown
+    }
+};
+
+#define RECORDING_PSRAM_BYTES (2 * 1024 * 1024)  // About a minute of busy 300 LED output, idle frames are free
+#define RECORDING_BLOCK_BYTES (8 * 1024)  // Without PSRAM the recording goes to flash in blocks of this size
+#define RECORDING_BLOCKS 3                // Blocks in RAM, enough to ride out a slow flash erase
+#define RECORDING_FILE "/recording.fbr"
+
+// A filled block on its way to the flash writer task, a null block closes the file
+struct RecordingBlock {
+    uint8_t* data;
+    size_t size;
+};
+
+// Records the frames and button events in the compact format from FrameRecording.h, so the
+// output of a mode can be downloaded and replayed on a PC with tools/replay.cpp.
+// With PSRAM the whole recording stays in memory. Without it (esp32dev) there is no room for
+// more than a few seconds, so full blocks are handed to a task that appends them to a file in
+// the LittleFS partition, which holds about a minute and a half of busy output.
+// Record_Active is set back to 0 whenever a recording ends or can't start, so the page shows
+// the real state and a restart never starts a new recording over the last one.
+class FrameRecorder {
+public:
+    FrameRecorder(WebConfig& config) : webConfig(config), buffer(nullptr), bufferSize(0), toFlash(false),
+        recording(false), startTime(0), flashedBytes(0), freeBlocks(nullptr), fullBlocks(nullptr), fileClosed(nullptr), writeFailed(false) {}
+
+    // Starts a new recording, discarding the previous one
+    void start() {
+        finish();
+        if (!buffer && !freeBlocks) allocate();
+        if (toFlash ? !startFile() : !buffer) {
+            webConfig.setParam("Record_Active", 0.0f);
+            return;
+        }
+        encoder.begin(buffer, bufferSize, NUM_LEDS);
+        startTime = millis();
+        recording = true;
+    }
+
+    void stop() {
+        if (!recording) return;
+        finish();
+        webConfig.setParam("Record_Active", 0.0f);
+    }
+
+    void addFrame(const CRGB* leds) {
+        if (!recording) return;
+        uint32_t time = millis() - startTime;
+        if (!encoder.addFrame((const uint8_t*)leds, time)
+            && !(nextBlock() && encoder.addFrame((const uint8_t*)leds, time))) {
+            Serial.println("Recording full");
+            stop();
+        }
+    }
+
+    void addEvent(RecordEvent type, uint8_t value = 0) {
+        if (!recording) return;
+        uint32_t time = millis() - startTime;
+        if (!encoder.addEvent(type, value, time) && !(nextBlock() && encoder.addEvent(type, value, time))) {
+            Serial.println("Recording full");
+            stop();
+        }
+    }
+
+    // A recording still running is stopped first, the file can't be read while it grows.
+    // The file in flash survives a restart, so it can also be fetched after a power cycle.
+    void download(WebServer& server) {
+        stop();
+        if (!buffer && !freeBlocks) allocate();
+        if (toFlash && LittleFS.exists(RECORDING_FILE)) {
+            File file = LittleFS.open(RECORDING_FILE, "r");
+            if (file.size() > 0) {
+                server.sendHeader("Content-Disposition", "attachment; filename=recording.fbr");
+                server.streamFile(file, "application/octet-stream");
+                file.close();
+                return;
+            }
+            file.close();
+        } else if (!toFlash && buffer && encoder.size() > 0) {
+            server.sendHeader("Content-Disposition", "attachment; filename=recording.fbr");
+            server.setContentLength(encoder.size());
+            server.send(200, "application/octet-stream", "");
+            server.sendContent((const char*)encoder.data(), encoder.size());
+            return;
+        }
+        server.send(404, "text/plain", "Nothing recorded yet");
+    }
+
+private:
+    WebConfig& webConfig;
+    FrameEncoder encoder;
+    uint8_t* buffer;   // PSRAM: allocated on the first recording and kept for the download. Flash: current block.
+    size_t bufferSize;
+    bool toFlash;
+    bool recording;
+    unsigned long startTime;
+    size_t flashedBytes;           // Bytes the writer task got into the file, read after stop()
+    QueueHandle_t freeBlocks;      // RecordingBlocks the encoder can fill next
+    QueueHandle_t fullBlocks;      // RecordingBlocks waiting to be written to the file
+    SemaphoreHandle_t fileClosed;  // Given by the writer task after a close request
+    volatile bool writeFailed;     // Set by the writer task when the partition is full
+    File file;                     // Only used by the writer task while recording
+
+    // Ends the recording and makes sure everything is stored, without touching Record_Active
+    void finish() {
+        if (!recording) return;
+        recording = false;
+        if (toFlash) {
+            // Hand over the partly filled block and wait until everything is in the file
+            handOver();
+            RecordingBlock close = { nullptr, 0 };
+            xQueueSend(fullBlocks, &close, portMAX_DELAY);
+            xSemaphoreTake(fileClosed, portMAX_DELAY);
+            buffer = nullptr;
+        }
+        Serial.printf("Recording stopped: %u frames, %u events, %u bytes\n",
+                      encoder.frames(), encoder.events(), (unsigned)(toFlash ? flashedBytes : encoder.size()));
+    }
+
+    void allocate() {
+        if (psramFound()) {
+            bufferSize = RECORDING_PSRAM_BYTES;
+            buffer = (uint8_t*)ps_malloc(bufferSize);
+            if (!buffer) {
+                Serial.println("Not enough memory for recording");
+                bufferSize = 0;
+            }
+            return;
+        }
+
+        if (!LittleFS.begin(true)) { // Formats the partition on first use
+            Serial.println("No flash filesystem for recording");
+            return;
+        }
+        freeBlocks = xQueueCreate(RECORDING_BLOCKS, sizeof(RecordingBlock));
+        fullBlocks = xQueueCreate(RECORDING_BLOCKS + 1, sizeof(RecordingBlock));
+        fileClosed = xSemaphoreCreateBinary();
+        for (int i = 0; i < RECORDING_BLOCKS; i++) {
+            RecordingBlock block = { (uint8_t*)malloc(RECORDING_BLOCK_BYTES), 0 };
+            if (block.data) xQueueSend(freeBlocks, &block, 0);
+        }
+        // Same priority as loop(), on the other core, so flash writes don't hold up the frames
+        xTaskCreatePinnedToCore(writerTask, "recorder", 4096, this, 1, nullptr, 0);
+        toFlash = true;
+    }
+
+    bool startFile() {
+        RecordingBlock block;
+        if (xQueueReceive(freeBlocks, &block, 0) != pdTRUE) {
+            Serial.println("Not enough memory for recording");
+            return false;
+        }
+        file = LittleFS.open(RECORDING_FILE, "w");
+        if (!file) {
+            xQueueSend(freeBlocks, &block, 0);
+            Serial.println("Could not create " RECORDING_FILE);
+            return false;
+        }
+        buffer = block.data;
+        bufferSize = RECORDING_BLOCK_BYTES;
+        flashedBytes = 0;
+        writeFailed = false;
+        Serial.printf("Recording to flash, %u bytes free\n", (unsigned)(LittleFS.totalBytes() - LittleFS.usedBytes()));
+        return true;
+    }
+
+    void handOver() {
+        RecordingBlock full = { buffer, encoder.size() };
+        xQueueSend(fullBlocks, &full, portMAX_DELAY); // Never blocks, the queue has room for every block
+    }
+
+    // Swaps the filled block for an empty one. Fails when the flash can't keep up or is full.
+    bool nextBlock() {
+        if (!toFlash || writeFailed) return false;
+        RecordingBlock next;
+        if (xQueueReceive(freeBlocks, &next, 0) != pdTRUE) {
+            Serial.println("Flash is too slow for the recording");
+            return false;
+        }
+        handOver();
+        buffer = next.data;
+        encoder.continueIn(buffer, bufferSize);
+        return true;
+    }
+
+    static void writerTask(void* parameter) {
+        FrameRecorder* recorder = (FrameRecorder*)parameter;
+        RecordingBlock block;
+        while (true) {
+            xQueueReceive(recorder->fullBlocks, &block, portMAX_DELAY);
+            if (!block.data) {
+                recorder->file.close();
+                xSemaphoreGive(recorder->fileClosed);
+                continue;
+            }
+            if (!recorder->writeFailed) {
+                size_t written = recorder->file.write(block.data, block.size);
+                recorder->flashedBytes += written;
+                // The partition is full. Replay decodes everything up to the cut-off record.
+                if (written != block.size) recorder->writeFailed = true;
+            }
+            block.size = 0;
+            xQueueSend(recorder->freeBlocks, &block, portMAX_DELAY);
+        }
+    }
+};
+
 // Global WebConfig object
 WebConfig webConfig("esp32_bob", "12345678");
-RunningDot runningDot;
+OutputStage outputStage;
+RunningDot runningDot(outputStage);
+QuizNode quizNode;
+IdleGovernor idleGovernor(webConfig);
+FrameRecorder frameRecorder(webConfig);
+bool recordingRequested = false;
 
 bool laststate = false;
 
+QuizNode::Role quizRoleSetting() {
+    return (QuizNode::Role)constrain((int)webConfig.getParamFloat("Quiz_Role"), 0, 2);
+}
+
+uint8_t quizIdSetting() {
+    return constrain((int)webConfig.getParamFloat("Quiz_Id"), 1, QUIZ_MAX_DEVICES - 1);
+}
+
+// True when the quiz node doesn't match the configured role or, for a client, its id
+bool quizSettingsChanged() {
+    QuizNode::Role role = quizRoleSetting();
+    return role != quizNode.getRole() || (role == QuizNode::CLIENT && quizIdSetting() != quizNode.getId());
+}
+
+// (Re)start the quiz node with the configured role. A client's id is part of its access
+// point address, so changing it means leaving and joining the host's network again.
+void startQuiz() {
+    QuizNode::Role role = quizRoleSetting();
+    uint8_t id = quizIdSetting();
+    bool wasClient = quizNode.getRole() == QuizNode::CLIENT;
+    bool isClient = role == QuizNode::CLIENT;
+    if (wasClient && (!isClient || id != quizNode.getId())) {
+        webConfig.leaveNetwork();
+    }
+    if (isClient && (!wasClient || id != quizNode.getId())) {
+        webConfig.joinNetwork("esp32_bob", "12345678", id);
+    }
+    quizNode.begin(role, id, webConfig.getParamFloat("Quiz_LockSeconds"));
+}
+
 void setup() {
     Serial.begin(115200);
     delay(1000);
@@ -695,21 +1462,54 @@ void setup() {
     webConfig.addParamFloat("Speed", 30);
     webConfig.addParamFloat("Brightness", 30);
     webConfig.addParamFloat("Width", 30);
+    webConfig.addParamFloat("Output_Gamma", DEFAULT_GAMMA);
+    webConfig.addParamFloat("Output_WhiteRed", 1.0);    // White balance, scale of each channel 0..1
+    webConfig.addParamFloat("Output_WhiteGreen", 1.0);
+    webConfig.addParamFloat("Output_WhiteBlue", 1.0);
+    webConfig.addParamFloat("Quiz_Role", 0);         // 0 = off, 1 = host, 2 = client
+    webConfig.addParamFloat("Quiz_Id", 1);           // Unique per client, 1..15
+    webConfig.addParamFloat("Quiz_LockSeconds", 5);  // How long the winner stays lit
+    webConfig.addParamFloat("Power_SleepSeconds", 300);  // Idle time before light sleep, 0 = never
+    webConfig.addParamFloat("Record_Active", 0);  // 1 starts a new recording, 0 stops it
+    webConfig.on("/power", [](WebServer& server) { server.send(200, "text/plain", idleGovernor.report()); });
+    webConfig.on("/recording.fbr", [](WebServer& server) { frameRecorder.download(server); });
     
     webConfig.begin(); // Start the AP and web server
+    webConfig.setParam("Record_Active", 0.0f);  // Never record over the last file after a restart
     runningDot.setBrightness(webConfig.getParamFloat("Brightness"));
     runningDot.setSpeed(webConfig.getParamFloat("Speed"));
     runningDot.begin();
     pinMode(BUTTON_PIN, INPUT_PULLUP);
-
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), onButtonEdge, CHANGE);
+    startQuiz();
+    idleGovernor.begin();
 }
 
 
 void loop() {
     webConfig.handleClient(); // Handle client requests
 
+    if (quizSettingsChanged()) {
+        startQuiz();
+    }
+    quizNode.setLockTime(webConfig.getParamFloat("Quiz_LockSeconds"));
+    quizNode.update();
+
+    bool recordingWanted = webConfig.getParamFloat("Record_Active") > 0;
+    if (recordingWanted != recordingRequested) {
+        recordingRequested = recordingWanted;
+        if (recordingWanted) {
+            frameRecorder.start();
+        } else {
+            frameRecorder.stop();
+        }
+    }
+
     bool state = !digitalRead(BUTTON_PIN);
-    if (state && !laststate) {
+    if (state != laststate) {
+        frameRecorder.addEvent(state ? EVENT_BUTTON_DOWN : EVENT_BUTTON_UP);
+    }
+    if (state && !laststate && !quizNode.isLockedOut()) {
         // Trigger the running dot when the button is pressed
         runningDot.trigger();
         Serial.println("Pressed");
@@ -718,6 +1518,18 @@ void loop() {
     runningDot.setBrightness(webConfig.getParamFloat("Brightness"));
     runningDot.setSpeed(webConfig.getParamFloat("Speed"));
     runningDot.setWidth(webConfig.getParamFloat("Width"));
+    outputStage.setGamma(webConfig.getParamFloat("Output_Gamma"));
+    outputStage.setWhiteBalance(webConfig.getParamFloat("Output_WhiteRed"),
+                                webConfig.getParamFloat("Output_WhiteGreen"),
+                                webConfig.getParamFloat("Output_WhiteBlue"));
+    runningDot.setFill(quizNode.isWinner(), CRGB(webConfig.getParamFloat("Color_Red"),
+                                                 webConfig.getParamFloat("Color_Green"),
+                                                 webConfig.getParamFloat("Color_Blue")));
+    idleGovernor.setSleepAfter(webConfig.getParamFloat("Power_SleepSeconds"));
     laststate = state;
-    runningDot.update();
+    if (runningDot.update()) {
+        frameRecorder.addFrame(runningDot.getLeds());
+    }
+    // The quiz needs the radio and a fast loop, so it keeps the unit awake
+    idleGovernor.update(runningDot.isIdle() && quizNode.getRole() == QuizNode::OFF);
 }
@@ -0,0 +1,291 @@
+// Host-side simulation of the quiz mode: one process plays the host unit, the others play
+// client buzzers with skewed clocks and laggy networks, all talking over loopback UDP with
+// the same QuizSync.h logic the firmware uses.
+//
+// Build and run on Linux:
+//   g++ -std=c++11 -O2 -pthread -I../include quizsim.cpp -o quizsim
+//   ./quizsim [clients] [rounds]
+//
+// Each round every device presses at a known true time (100us apart, random order) and
+// the earliest presser gets the largest network delay, so its packet arrives last.
+// Like the firmware, packets are stamped by a receive thread as they arrive, while the
+// protocol loop only gets to them between frames, here every 1..9ms.
+// The exit code is the number of rounds the host got wrong.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "QuizSync.h"
+
+#define SIM_PRESS_SPACING_US 100   // True time between consecutive presses in a round
+#define SIM_ROUND_PERIOD_US 1000000
+#define SIM_WARMUP_US 1500000      // Time given to clients to sync before the first round
+#define SIM_MAX_NET_DELAY_US 8000  // Extra send delay for the earliest presser
+#define SIM_LOCK_TIME_US 300000
+#define SIM_MIN_LOOP_US 1000       // The firmware loop spends up to ~9ms in FastLED.show()
+#define SIM_MAX_LOOP_US 9000
+
+static int64_t monotonicMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int openSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        exit(100);
+    }
+    timeval timeout = {0, 100000};  // Lets the receive thread notice when it should stop
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static void sendMessage(int fd, const QuizMessage& msg, const sockaddr_in& to) {
+    uint8_t buffer[QUIZ_MESSAGE_SIZE];
+    size_t length = msg.encode(buffer);
+    sendto(fd, buffer, length, 0, (const sockaddr*)&to, sizeof(to));
+}
+
+// Stand-in for the AsyncUDP task: blocks on the socket, stamps each packet on arrival and
+// queues it for the protocol loop
+class Receiver {
+public:
+    struct Packet {
+        QuizMessage message;
+        int64_t rxTime;
+        sockaddr_in from;
+    };
+
+    explicit Receiver(int fd) : fd(fd), running(true), thread(&Receiver::run, this) {}
+
+    ~Receiver() {
+        running = false;
+        thread.join();
+    }
+
+    bool take(Packet& packet) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) return false;
+        packet = queue.front();
+        queue.pop_front();
+        return true;
+    }
+
+private:
+    int fd;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::deque<Packet> queue;
+    std::thread thread;
+
+    void run() {
+        while (running) {
+            uint8_t buffer[64];
+            Packet packet;
+            socklen_t fromLength = sizeof(packet.from);
+            ssize_t length = recvfrom(fd, buffer, sizeof(buffer), 0, (sockaddr*)&packet.from, &fromLength);
+            packet.rxTime = monotonicMicros();
+            if (length <= 0 || !packet.message.decode(buffer, (size_t)length)) continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(packet);
+        }
+    }
+};
+
+// Time spent rendering and showing a frame before the loop looks at the network again
+static void loopLatency(std::mt19937& rng) {
+    std::uniform_int_distribution<int> latency(SIM_MIN_LOOP_US, SIM_MAX_LOOP_US);
+    usleep(latency(rng));
+}
+
+struct Schedule {
+    int64_t start;                            // Monotonic time of round 0
+    std::vector<std::vector<int64_t>> press;  // press[round][device] = true press time
+    std::vector<std::vector<int64_t>> delay;  // delay[round][device] = simulated network delay
+    std::vector<uint8_t> expectedWinner;
+};
+
+static Schedule makeSchedule(int devices, int rounds) {
+    std::mt19937 rng((unsigned)time(nullptr));
+    Schedule s;
+    s.start = monotonicMicros() + SIM_WARMUP_US;
+    for (int r = 0; r < rounds; r++) {
+        std::vector<int> order(devices);
+        for (int d = 0; d < devices; d++) order[d] = d;
+        std::shuffle(order.begin(), order.end(), rng);
+
+        int64_t roundStart = s.start + (int64_t)r * SIM_ROUND_PERIOD_US;
+        std::vector<int64_t> press(devices), delay(devices);
+        for (int rank = 0; rank < devices; rank++) {
+            int d = order[rank];
+            press[d] = roundStart + rank * SIM_PRESS_SPACING_US;
+            // Earlier pressers get slower networks, so arrival order is the reverse of press order
+            delay[d] = SIM_MAX_NET_DELAY_US * (devices - 1 - rank) / std::max(1, devices - 1);
+        }
+        s.press.push_back(press);
+        s.delay.push_back(delay);
+        s.expectedWinner.push_back((uint8_t)order[0]);
+    }
+    return s;
+}
+
+static int runHost(const Schedule& s, int devices, int rounds) {
+    int fd = openSocket(QUIZ_PORT);
+    QuizHost host(SIM_LOCK_TIME_US);
+    std::vector<sockaddr_in> peers(QUIZ_MAX_DEVICES);
+    std::vector<bool> known(QUIZ_MAX_DEVICES, false);
+    host.begin(monotonicMicros());
+    Receiver receiver(fd);
+    std::mt19937 rng(QUIZ_HOST_ID);
+
+    int decided = 0;
+    int64_t worstError = 0;
+    int errors = 0;
+    bool pressedThisRound = false;
+    int64_t end = s.start + (int64_t)rounds * SIM_ROUND_PERIOD_US;
+    while (monotonicMicros() < end) {
+        QuizMessage out;
+        Receiver::Packet packet;
+        while (receiver.take(packet)) {
+            if (packet.message.type == QUIZ_SYNC_REQUEST) {
+                peers[packet.message.deviceId] = packet.from;
+                known[packet.message.deviceId] = true;
+            }
+            if (host.handle(packet.message, packet.rxTime, out)) {
+                out.t2 = monotonicMicros();
+                sendMessage(fd, out, packet.from);
+            }
+        }
+
+        // The host's own button is device 0 and is stamped directly, no network involved
+        int64_t now = monotonicMicros();
+        if (decided < rounds && !pressedThisRound && now >= s.press[decided][QUIZ_HOST_ID]) {
+            host.localPress(s.press[decided][QUIZ_HOST_ID], now);
+            pressedThisRound = true;
+        }
+
+        if (host.update(now, out)) {
+            for (int d = 1; d < devices; d++) {
+                if (known[d]) sendMessage(fd, out, peers[d]);
+            }
+            if (out.winnerId != QUIZ_NO_WINNER && decided < rounds) {
+                int64_t error = out.t0 - s.press[decided][out.winnerId];
+                bool ok = out.winnerId == s.expectedWinner[decided];
+                printf("round %d: winner %d (expected %d) timestamp error %lld us %s\n", decided,
+                       out.winnerId, s.expectedWinner[decided], (long long)error, ok ? "ok" : "WRONG");
+                if (!ok) errors++;
+                worstError = std::max(worstError, error < 0 ? -error : error);
+                decided++;
+                pressedThisRound = false;
+            }
+        }
+        loopLatency(rng);
+    }
+    if (decided < rounds) {
+        printf("only %d of %d rounds were decided\n", decided, rounds);
+        errors += rounds - decided;
+    }
+    printf("largest winner timestamp error %lld us\n", (long long)worstError);
+    return errors;
+}
+
+static int runClient(const Schedule& s, uint8_t id, int rounds) {
+    int fd = openSocket(QUIZ_PORT + id);
+    sockaddr_in hostAddr = {};
+    hostAddr.sin_family = AF_INET;
+    hostAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    hostAddr.sin_port = htons(QUIZ_PORT);
+
+    // Every device boots at a different time, so its local clock is far off the host clock
+    srand(id * 7919);
+    int64_t clockOffset = (rand() % 20000000) - 10000000;
+    QuizClient client(id);
+    Receiver receiver(fd);
+    std::mt19937 rng(id);
+
+    int round = 0;
+    bool pressed = false;
+    QuizMessage press;
+    int64_t end = s.start + (int64_t)rounds * SIM_ROUND_PERIOD_US;
+    while (monotonicMicros() < end) {
+        QuizMessage out;
+        Receiver::Packet packet;
+        while (receiver.take(packet)) {
+            client.handle(packet.message, packet.rxTime + clockOffset);
+        }
+        int64_t now = monotonicMicros();
+        if (client.wantsSync(now + clockOffset, out)) {
+            sendMessage(fd, out, hostAddr);
+        }
+
+        if (round < rounds) {
+            // Stand-in for the ISR: the timestamp is taken at the true press time
+            if (!pressed && now >= s.press[round][id]) {
+                pressed = client.makePress(s.press[round][id] + clockOffset, press);
+                if (!pressed) {
+                    fprintf(stderr, "client %d: could not press in round %d\n", id, round);
+                    round++;
+                }
+            }
+            if (pressed && now >= s.press[round][id] + s.delay[round][id]) {
+                for (int i = 0; i < QUIZ_PRESS_REPEATS; i++) sendMessage(fd, press, hostAddr);
+                pressed = false;
+                round++;
+            }
+        }
+        loopLatency(rng);
+    }
+    printf("client %d: offset %lld us, sync uncertainty %lld us\n", id,
+           (long long)client.clockSync().offset(), (long long)client.clockSync().uncertainty());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int devices = argc > 1 ? atoi(argv[1]) + 1 : 5;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+    if (devices < 2 || devices > QUIZ_MAX_DEVICES || rounds < 1) {
+        fprintf(stderr, "usage: %s [clients 1..%d] [rounds]\n", argv[0], QUIZ_MAX_DEVICES - 1);
+        return 100;
+    }
+
+    Schedule s = makeSchedule(devices, rounds);
+
+    std::vector<pid_t> children;
+    for (int d = 0; d < devices; d++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            return d == QUIZ_HOST_ID ? runHost(s, devices, rounds) : runClient(s, (uint8_t)d, rounds);
+        }
+        children.push_back(pid);
+    }
+
+    int errors = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+        int status = 0;
+        waitpid(children[i], &status, 0);
+        errors += WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+    printf("%d round(s) wrong\n", errors);
+    return errors;
+}
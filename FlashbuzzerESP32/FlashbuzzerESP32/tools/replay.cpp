@@ -0,0 +1,209 @@
+// Decodes a recording downloaded from http://8.8.8.8/recording.fbr on a PC.
+//
+// Build and run on Linux:
+//   g++ -std=c++11 -O2 -I../include replay.cpp -o replay
+//   ./replay recording.fbr                   statistics about the frames and the mode that produced them
+//   ./replay recording.fbr --events          also list every input event
+//   ./replay recording.fbr --ppm strip.ppm   timeline image, one row per frame, one column per LED
+//   ./replay recording.fbr --diff other.fbr  compare frame by frame, exit code 1 if they differ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "FrameRecording.h"
+
+static bool readFile(const char* path, std::vector<uint8_t>& contents) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        contents.insert(contents.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static double secondsSince(const timespec& start) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static const char* eventName(uint8_t type) {
+    switch (type) {
+        case EVENT_BUTTON_DOWN: return "button down";
+        case EVENT_BUTTON_UP: return "button up";
+        default: return "unknown";
+    }
+}
+
+// Decode everything once and print what the mode did
+static int printStats(const std::vector<uint8_t>& recording, bool listEvents, FILE* ppm) {
+    FrameDecoder decoder;
+    if (!decoder.begin(recording.data(), recording.size())) {
+        fprintf(stderr, "not a FlashBuzzer recording\n");
+        return 2;
+    }
+    size_t frameBytes = (size_t)decoder.leds() * 3;
+    std::vector<uint8_t> previous(frameBytes, 0);
+    std::vector<uint8_t> image;
+
+    uint32_t frames = 0, events = 0;
+    uint32_t firstTime = 0, lastFrameTime = 0;
+    uint32_t minInterval = UINT32_MAX, maxInterval = 0;
+    uint64_t litLeds = 0, changedLeds = 0;
+
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    FrameDecoder::Result result;
+    while ((result = decoder.next()) == FrameDecoder::FRAME || result == FrameDecoder::EVENT) {
+        if (result == FrameDecoder::EVENT) {
+            events++;
+            if (listEvents) {
+                printf("%10.3f s  %s (%d)\n", decoder.time() / 1000.0, eventName(decoder.lastEventType()),
+                       decoder.lastEventValue());
+            }
+            continue;
+        }
+
+        const uint8_t* frame = decoder.frameData();
+        if (frames == 0) {
+            firstTime = decoder.time();
+        } else {
+            uint32_t interval = decoder.time() - lastFrameTime;
+            if (interval < minInterval) minInterval = interval;
+            if (interval > maxInterval) maxInterval = interval;
+        }
+        for (size_t i = 0; i < frameBytes; i += 3) {
+            if (frame[i] | frame[i + 1] | frame[i + 2]) litLeds++;
+            if (memcmp(frame + i, previous.data() + i, 3) != 0) changedLeds++;
+        }
+        memcpy(previous.data(), frame, frameBytes);
+        if (ppm) image.insert(image.end(), frame, frame + frameBytes);
+        lastFrameTime = decoder.time();
+        frames++;
+    }
+    double decodeSeconds = secondsSince(start);
+
+    if (result == FrameDecoder::CORRUPT) {
+        printf("recording is corrupt after %u frames, showing what decoded\n", frames);
+    }
+    double duration = (lastFrameTime - firstTime) / 1000.0;
+    printf("LEDs:            %u\n", decoder.leds());
+    printf("frames:          %u over %.1f s", frames, duration);
+    if (duration > 0) printf(" (%.1f fps)", (frames - 1) / duration);
+    printf("\n");
+    if (frames > 1) printf("frame interval:  %u .. %u ms\n", minInterval, maxInterval);
+    printf("events:          %u\n", events);
+    if (frames > 0) {
+        printf("lit LEDs:        %.1f per frame\n", (double)litLeds / frames);
+        printf("changed LEDs:    %.1f per frame\n", (double)changedLeds / frames);
+        printf("size:            %zu bytes, %.1f bytes per frame (raw %zu, %.1fx smaller)\n", recording.size(),
+               (double)recording.size() / frames, frameBytes, (double)frameBytes * frames / recording.size());
+        printf("decode speed:    %.0f frames/s\n", decodeSeconds > 0 ? frames / decodeSeconds : 0.0);
+    }
+
+    if (ppm && frames > 0) {
+        // Color order on the wire is whatever the firmware's CRGB holds, i.e. R, G, B
+        fprintf(ppm, "P6\n%u %u\n255\n", decoder.leds(), frames);
+        fwrite(image.data(), 1, image.size(), ppm);
+    }
+    return result == FrameDecoder::CORRUPT ? 2 : 0;
+}
+
+// Compare two recordings frame by frame, ignoring timing
+static int diffRecordings(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    FrameDecoder left, right;
+    if (!left.begin(a.data(), a.size()) || !right.begin(b.data(), b.size())) {
+        fprintf(stderr, "not a FlashBuzzer recording\n");
+        return 2;
+    }
+    if (left.leds() != right.leds()) {
+        printf("LED count differs: %u vs %u\n", left.leds(), right.leds());
+        return 1;
+    }
+
+    size_t frameBytes = (size_t)left.leds() * 3;
+    uint32_t frame = 0, differing = 0;
+    int maxDifference = 0;
+    while (true) {
+        FrameDecoder::Result l, r;
+        while ((l = left.next()) == FrameDecoder::EVENT) {}
+        while ((r = right.next()) == FrameDecoder::EVENT) {}
+        if (l != FrameDecoder::FRAME || r != FrameDecoder::FRAME) {
+            if (l == FrameDecoder::FRAME || r == FrameDecoder::FRAME) {
+                printf("frame count differs, one recording ends at frame %u\n", frame);
+                differing++;
+            }
+            break;
+        }
+
+        int difference = 0;
+        size_t firstLed = 0;
+        for (size_t i = 0; i < frameBytes; i++) {
+            int d = abs((int)left.frameData()[i] - (int)right.frameData()[i]);
+            if (d > difference) {
+                if (difference == 0) firstLed = i / 3;
+                difference = d;
+            }
+        }
+        if (difference > 0) {
+            if (differing == 0) {
+                printf("first difference at frame %u (%.3f s), LED %zu\n", frame, left.time() / 1000.0, firstLed);
+            }
+            differing++;
+            if (difference > maxDifference) maxDifference = difference;
+        }
+        frame++;
+    }
+    printf("%u of %u frames differ, largest channel difference %d\n", differing, frame, maxDifference);
+    return differing > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s recording.fbr [--events] [--ppm out.ppm] [--diff other.fbr]\n", argv[0]);
+        return 2;
+    }
+    std::vector<uint8_t> recording;
+    if (!readFile(argv[1], recording)) return 2;
+
+    bool listEvents = false;
+    const char* ppmPath = nullptr;
+    const char* diffPath = nullptr;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0) {
+            listEvents = true;
+        } else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppmPath = argv[++i];
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            diffPath = argv[++i];
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if (diffPath) {
+        std::vector<uint8_t> other;
+        if (!readFile(diffPath, other)) return 2;
+        return diffRecordings(recording, other);
+    }
+
+    FILE* ppm = nullptr;
+    if (ppmPath && !(ppm = fopen(ppmPath, "wb"))) {
+        perror(ppmPath);
+        return 2;
+    }
+    int status = printStats(recording, listEvents, ppm);
+    if (ppm) fclose(ppm);
+    return status;
+}
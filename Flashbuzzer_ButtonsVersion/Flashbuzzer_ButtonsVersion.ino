@@ -6,6 +6,9 @@
 #define LED_TYPE        WS2811
 #define COLOR_ORDER     RGB
 #define SETTINGS_COUNT  16
+#define PALETTE_SIZE    256
+#define PALETTE_SEGMENT_SHIFT 6
+#define PALETTE_AMOUNT_MASK   0x3F
 
 // CRGB leds[NUM_LEDS];
 CRGB leds[NUM_LEDS]; //Initialize led array with nubmer of elements from eeprom
@@ -293,6 +296,8 @@ class Setting {
 class LEDSettingsManager {
     public:
         Setting settings[SETTINGS_COUNT];
+        unsigned int revision = 0; // Incremented on every change, lets caches like the Palette know when to rebuild
+
         LEDSettingsManager() {
             // Initialize settings with default values
             initialize();
@@ -301,6 +306,7 @@ class LEDSettingsManager {
 
         void setSetting(LEDSetting setting, int value) {
             settings[setting].value = constrain(value, settings[setting].minimum, settings[setting].maximum);
+            revision++;
         }
 
         int getSetting(LEDSetting setting) {
@@ -309,10 +315,12 @@ class LEDSettingsManager {
 
         void incrementSetting(LEDSetting setting) {
             settings[setting].increase();
+            revision++;
         }
 
         void decrementSetting(LEDSetting setting) {
             settings[setting].decrease();
+            revision++;
         }
 
         void drawSetting(CRGB leds[], LEDSetting setting) {
@@ -343,6 +351,7 @@ class LEDSettingsManager {
                 EEPROM.get(address, settings[i].value);
                 address += sizeof(int); // Move to the next address
             }      
+            revision++;
         }
 
         void initialize(){
@@ -362,6 +371,7 @@ class LEDSettingsManager {
             settings[RANDOM] = Setting(0, 1024, 1, 1, CRGB::White);
             settings[BROKEN_MODE] = Setting(0, 10, 1, 1, CRGB::White);
             settings[BROKEN_THRESHOLD] = Setting(0, 255, 50, 1, CRGB::White);
+            revision++;
         }
 
         void resetToDefault(){
@@ -378,23 +388,88 @@ class LEDSettingsManager {
         }
 };
 
+// PALETTE
+
+enum PaletteStyle {
+    PALETTE_STEPS,    // Hard color steps at Index1 and Index2
+    PALETTE_GRADIENT  // Smooth blend Color1 -> Color2 up to Index1, Color2 -> Color3 up to Index2
+};
+
+// Colors are not stored per index, that would be 768 bytes of the 328P's 2KB next to leds[].
+// Each entry holds the segment in the top 2 bits (0: Color1 -> Color2, 1: Color2 -> Color3,
+// 2: Color3) and the blend amount in the low 6 bits; get() does the blend.
+class Palette {
+    private:
+        uint8_t lut[PALETTE_SIZE]; // Segment and blend amount for every LED index
+        CRGB colors[3];
+        unsigned int compiledRevision = 0;
+        PaletteStyle compiledStyle = PALETTE_STEPS;
+        bool compiled = false;
+
+        void compile(LEDSettingsManager &settings, PaletteStyle style) {
+            colors[0] = CRGB(settings.getSetting(COLOR_RED), settings.getSetting(COLOR_GREEN), settings.getSetting(COLOR_BLUE));
+            colors[1] = CRGB(settings.getSetting(COLOR_RED2), settings.getSetting(COLOR_GREEN2), settings.getSetting(COLOR_BLUE2));
+            colors[2] = CRGB(settings.getSetting(COLOR_RED3), settings.getSetting(COLOR_GREEN3), settings.getSetting(COLOR_BLUE3));
+            int index1 = settings.getSetting(INDEX1);
+            int index2 = settings.getSetting(INDEX2);
+
+            for (int i = 0; i < PALETTE_SIZE; i++) {
+                uint8_t segment, amount = 0;
+                if (i < index1) {
+                    segment = 0;
+                    if (style == PALETTE_GRADIENT) amount = map(i, 0, index1, 0, PALETTE_AMOUNT_MASK);
+                } else if (i < index2) {
+                    segment = 1;
+                    if (style == PALETTE_GRADIENT) amount = map(i, index1, index2, 0, PALETTE_AMOUNT_MASK);
+                } else {
+                    segment = 2;
+                }
+                lut[i] = (segment << PALETTE_SEGMENT_SHIFT) | amount;
+            }
+        }
+
+    public:
+        // Rebuild the table if the settings or the style changed since the last call, cheap otherwise
+        void prepare(LEDSettingsManager &settings, PaletteStyle style) {
+            if (!compiled || settings.revision != compiledRevision || style != compiledStyle) {
+                compile(settings, style);
+                compiledRevision = settings.revision;
+                compiledStyle = style;
+                compiled = true;
+            }
+        }
+
+        CRGB get(int index) {
+            uint8_t entry = lut[constrain(index, 0, PALETTE_SIZE - 1)];
+            uint8_t segment = entry >> PALETTE_SEGMENT_SHIFT;
+            uint8_t amount = entry & PALETTE_AMOUNT_MASK;
+            if (amount == 0) {
+                return colors[segment];
+            }
+            return blend(colors[segment], colors[segment + 1], (amount << 2) | (amount >> 4)); // 6 -> 8 bits
+        }
+};
+
+// Shared by all modes, only one mode is active at a time
+Palette palette;
+
 // RUN MODES
 
 class LEDMode {
     public:
-        virtual void update(LEDSettingsManager settings, ControlManager controlManager) = 0;
-        virtual void init(LEDSettingsManager settings, ControlManager controlManager) = 0;
+        virtual void update(LEDSettingsManager &settings, ControlManager &controlManager) = 0;
+        virtual void init(LEDSettingsManager &settings, ControlManager &controlManager) = 0;
 };
 
 class RunningDotMode : public LEDMode {
     private:
 
     public:
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
           //empty init
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             bool newButtonState = digitalRead(BUTTON_PIN);
             if (controlManager.buzzer.pressed) {
                 CRGB color = settings.isDark() ? CRGB(random(255), random(255), random(255)) : settings.getColor(); // Random or white color if no color selected
@@ -417,11 +492,11 @@ class LightSwitchMode : public LEDMode {
         bool oldButtonState = HIGH;
 
     public:
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
           //empty init
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             bool newButtonState = !digitalRead(BUTTON_PIN);
             if (newButtonState == LOW && oldButtonState == HIGH) {
                 isOn = !isOn;
@@ -440,32 +515,23 @@ class GradualFillMode : public LEDMode {
     private:
         int ledIndex = 0; // Current LED index
         unsigned long lastUpdate = 0; // Last update time
-
-        CRGB getColorForIndex(LEDSettingsManager &settings, int index) {
-            int index1 = settings.getSetting(INDEX1);
-            int index2 = settings.getSetting(INDEX2);
-
-            if (index < index1) {
-                return CRGB(settings.getSetting(COLOR_RED), settings.getSetting(COLOR_GREEN), settings.getSetting(COLOR_BLUE));
-            } else if (index < index2) {
-                return CRGB(settings.getSetting(COLOR_RED2), settings.getSetting(COLOR_GREEN2), settings.getSetting(COLOR_BLUE2));
-            } else {
-                return CRGB(settings.getSetting(COLOR_RED3), settings.getSetting(COLOR_GREEN3), settings.getSetting(COLOR_BLUE3));
-            }
-        }
+        PaletteStyle style;
 
     public:
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
-          //empty init
+        GradualFillMode(PaletteStyle paletteStyle) : style(paletteStyle) {}
+
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
+            palette.prepare(settings, style);
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             unsigned long currentTime = millis();
             int speed = settings.getSetting(SPEED); // Get speed setting
+            palette.prepare(settings, style);
 
             if (controlManager.buzzer.state) {
                 if (currentTime - lastUpdate > speed && ledIndex < NUM_LEDS) {
-                    leds[ledIndex] = getColorForIndex(settings, ledIndex);
+                    leds[ledIndex] = palette.get(ledIndex);
                     ledIndex++;
                     lastUpdate = currentTime;
                 }
@@ -489,31 +555,19 @@ class GameMode : public LEDMode {
         int ledIndex = 0; // Current LED index
         unsigned long lastUpdate = 0; // Last update time
 
-        CRGB getColorForIndex(LEDSettingsManager &settings, int index) {
-            int index1 = settings.getSetting(INDEX1);
-            int index2 = settings.getSetting(INDEX2);
-
-            if (index < index1) {
-                return CRGB(settings.getSetting(COLOR_RED), settings.getSetting(COLOR_GREEN), settings.getSetting(COLOR_BLUE));
-            } else if (index < index2) {
-                return CRGB(settings.getSetting(COLOR_RED2), settings.getSetting(COLOR_GREEN2), settings.getSetting(COLOR_BLUE2));
-            } else {
-                return CRGB(settings.getSetting(COLOR_RED3), settings.getSetting(COLOR_GREEN3), settings.getSetting(COLOR_BLUE3));
-            }
-        }
-
     public:
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
-          //empty init
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
+            palette.prepare(settings, PALETTE_STEPS);
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             unsigned long currentTime = millis();
             int speed = settings.getSetting(SPEED); // Get speed setting
+            palette.prepare(settings, PALETTE_STEPS);
 
             if (controlManager.buzzer.state) {
                 if (currentTime - lastUpdate > speed && ledIndex < NUM_LEDS) {
-                    leds[ledIndex] = getColorForIndex(settings, ledIndex);
+                    leds[ledIndex] = palette.get(ledIndex);
                     ledIndex++;
                     lastUpdate = currentTime;
                 }
@@ -552,14 +606,14 @@ class GameMode : public LEDMode {
 
 //   public:
 
-//     void init(LEDSettingsManager settings, ControlManager controlManager) override {
+//     void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
 //       baseLEDCount = 3;
 //       movingAway = false;
 //       baseBlinkCounter = 0;
 //       gameState = WAIT_ON_START;
 //     }
 
-//     void update(LEDSettingsManager settings, ControlManager controlManager) override {
+//     void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
 //       switch (gameState) {
 //         case WAIT_ON_START:
 //           // Blink first 3 LEDs as attract mode
@@ -643,11 +697,11 @@ class LEDCounterMode : public LEDMode {
 
     public:
 
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
           //empty init
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             // Turn on additional LEDs with the green button
             if (controlManager.greenBtn.pressed) {
                 ledCount = min(ledCount + 10, NUM_LEDS);
@@ -674,11 +728,11 @@ class LEDCounterMode : public LEDMode {
 class DebugMode : public LEDMode {
     public:
 
-        void init(LEDSettingsManager settings, ControlManager controlManager) override {
+        void init(LEDSettingsManager &settings, ControlManager &controlManager) override {
           //empty init
         }
 
-        void update(LEDSettingsManager settings, ControlManager controlManager) override {
+        void update(LEDSettingsManager &settings, ControlManager &controlManager) override {
             // Set all LEDs to white
             fill_solid(leds, NUM_LEDS, CRGB::White);
         }
@@ -687,7 +741,8 @@ class DebugMode : public LEDMode {
 LEDMode* currentMode;
 RunningDotMode runningDotMode;
 LightSwitchMode lightSwitchMode;
-GradualFillMode gradualFillMode;
+GradualFillMode gradualFillMode(PALETTE_STEPS);
+GradualFillMode gradientFillMode(PALETTE_GRADIENT);
 GameMode gameMode;
 LEDCounterMode ledCounterMode;
 DebugMode debugMode;
@@ -752,6 +807,7 @@ void startMode(){
         case 2: currentMode = &gradualFillMode; break;
         case 3: currentMode = &gameMode; break;
         case 4: currentMode = &ledCounterMode; break;
+        case 5: currentMode = &gradientFillMode; break;
         case 15: currentMode = &debugMode; break;
         // Additional cases for other modes
     }